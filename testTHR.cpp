@@ -13,6 +13,10 @@
 
 g++ -Wall testTHR.cpp -o test
 
+с профилированием (см. "Профилирование")
+
+g++ -Wall -O2 -DSIEVE_PROFILE testTHR.cpp -o test
+
 */
 
 /*
@@ -46,6 +50,83 @@ v6
 v7
 с использованием распараллеленного решета Эратосфена (8 ядер) 
 ./test 622337203 ~ 5028 ms
+
+v8
+сегментированное решето с колесом по модулю 2 (битовые маски, сегмент помещается в кэш)
+Реализация, размер сегмента и количество потоков подбираются калибровкой (./test --tune)
+*/
+
+
+/*
+Калибровка
+
+./test --tune [N]
+    Замеряет время работы всех реализаций решета (v4, v6, v7, v8) до числа N (по умолчанию 50000000)
+    при разных размерах сегмента и количестве потоков, подобранных по размерам кэша и количеству ядер.
+    Лучшая конфигурация сохраняется для текущего хоста в файл $SIEVE_TUNE_FILE
+    (по умолчанию ~/.sieve_tune, по строке на хост).
+
+При обычном запуске конфигурация для хоста загружается из файла, и количество ядер не запрашивается.
+Если конфигурации нет, используется многопоточное решето (v7) с количеством ядер, введенным пользователем.
+*/
+
+
+/*
+Запросы к решету
+
+./test --query N
+    Строит решето до числа N (v8) и индекс rank/select над ним, затем читает запросы со стандартного ввода:
+        pi x     - количество простых чисел, не больших x
+        nth k    - k-е простое число
+        next x   - наименьшее простое число, большее x
+        bench M  - замер скорости на M случайных запросах
+        q        - выход
+    Индекс: на каждые 512 бит решета хранится количество единиц от начала блока (2 байта),
+    на каждые 65536 бит - количество единиц от начала решета (8 байт), и для каждого 8192-го
+    простого числа - номер 512-битного суперблока, в котором оно лежит. Дополнительно ~3% памяти решета,
+    pi - O(1), nth и next - поиск по суперблокам между двумя соседними отсчетами.
+*/
+
+
+/*
+Шардирование
+
+./test --shard L R N [префикс]
+    Делит диапазон [L, R] на N шардов, запускает N локальных процессов-обработчиков (одновременно - не больше,
+    чем ядер) и объединяет результат, если все обработчики завершились успешно.
+./test --shard-worker L R N i [префикс [потоки]]
+    Обрабатывает только шард с номером i (от 0 до N-1) - для запуска внешним планировщиком на разных машинах.
+./test --merge L R N [префикс]
+    Объединяет готовые файлы шардов "префикс.i.shard" в файл "префикс.merged" (префикс по умолчанию - sieve).
+
+Файл шарда: текстовый заголовок из строк "ключ значение" (формат, диапазон, номер шарда, границы шарда,
+количество простых чисел, первое и последнее простое, время работы, конфигурация, контрольная сумма FNV-1a
+и размер данных), строка "data", затем данные - простые числа в виде разностей соседних чисел
+в формате varint (первое число записывается как разность с левой границей шарда).
+Обработчик дописывает данные в файл после каждого окна решета, а числовые поля заголовка имеют фиксированную
+ширину и заполняются в конце, поэтому память обработчика не зависит от размера шарда.
+При объединении файлы шардов проверяются параллельно, затем их данные по частям переписываются в общий файл
+(в памяти данные шардов целиком не хранятся). Файл с данными сверх заявленного размера считается поврежденным.
+При ошибке программа завершается с кодом 1.
+*/
+
+
+/*
+Профилирование
+
+Включается при компиляции с -DSIEVE_PROFILE, без этого флага макросы PROFILE_* пустые и код не меняется.
+Замеряются:
+    - фазы работы (заполнение решета, вычеркивание первыми простыми числами, SearchSimple, сегменты v8,
+      построение индекса, вывод, чтение и запись шардов) - количество вызовов, суммарное и максимальное время;
+    - время работы каждого потока;
+    - счетчики: количество вычеркиваний, обработанных сегментов, созданных потоков, время простоя потоков
+      (время параллельного участка * количество потоков - время работы потоков);
+    - аппаратные счетчики через perf_event_open для фаз основного потока: такты, инструкции (IPC),
+      промахи кэша и промахи DTLB. Если счетчики недоступны (например, kernel.perf_event_paranoid),
+      они не выводятся. Отключаются переменной окружения SIEVE_PROFILE_HW=0.
+При завершении программы записываются файлы "префикс.pid.json" (отчет) и "префикс.pid.trace.json"
+(Chrome trace, открывается в chrome://tracing или ui.perfetto.dev), префикс задается переменной окружения
+SIEVE_PROFILE_OUT (по умолчанию sieve_profile).
 */
 
 
@@ -82,21 +163,310 @@ v7
 #include<cmath>
 #include <thread>
 #include <chrono>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <random>
+#include <map>
+#include <cstdio>
+#include <iomanip>
+#include <cstdlib>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <cerrno>
 
 #define ll long long
 
 using namespace std;
 
+
+//Профилирование (только при компиляции с -DSIEVE_PROFILE)
+#ifdef SIEVE_PROFILE
+
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+
+//фаза основного потока (с аппаратными счетчиками)
+#define PROFILE_PHASE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name, PROFILE_KIND_PHASE, 0)
+//работа потока (учитывается во времени работы потоков)
+#define PROFILE_WORKER(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name, PROFILE_KIND_WORKER, 0)
+//параллельный участок из th_quant потоков (для подсчета времени простоя)
+#define PROFILE_PARALLEL(name, th_quant) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name, PROFILE_KIND_PARALLEL, th_quant)
+//прочие замеры времени
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name, PROFILE_KIND_SCOPE, 0)
+#define PROFILE_COUNT(counter, n) (profiler.counter += (n))
+//локальный счетчик в горячем цикле (сбрасывается в profiler одним PROFILE_COUNT)
+#define PROFILE_LOCAL(var) unsigned ll var = 0
+#define PROFILE_LOCAL_ADD(var, n) (var += (n))
+#define PROFILE_REPORT() ProfileReport()
+
+enum ProfileKind{PROFILE_KIND_PHASE, PROFILE_KIND_WORKER, PROFILE_KIND_PARALLEL, PROFILE_KIND_SCOPE};
+
+//Аппаратные счетчики: такты, инструкции, промахи кэша, промахи DTLB
+const int PROFILE_HW_COUNT = 4;
+const char *profile_hw_names[PROFILE_HW_COUNT]{"cycles", "instructions", "cache_misses", "dtlb_misses"};
+
+//Замер времени (событие Chrome trace)
+struct ProfileEvent{
+    const char *name;
+    ProfileKind kind;
+    int tid;
+    unsigned ll start_ns, dur_ns;
+    bool has_hw;
+    unsigned ll hw[PROFILE_HW_COUNT];
+};
+
+struct Profiler{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    mutex lock;
+    vector<ProfileEvent> events;
+    int hw_fd[PROFILE_HW_COUNT]{-1, -1, -1, -1};
+    bool hw_enabled = false;
+    atomic<int> next_tid{0};
+
+    atomic<unsigned ll> crossings{0};   //вычеркиваний
+    atomic<unsigned ll> segments{0};    //обработанных сегментов v8
+    atomic<unsigned ll> threads{0};     //созданных потоков
+    atomic<unsigned ll> busy_ns{0};     //время работы потоков
+    atomic<unsigned ll> idle_ns{0};     //время простоя потоков
+
+    Profiler(){
+        const char *hw = getenv("SIEVE_PROFILE_HW");
+        if(hw && string(hw) == "0"){
+            return;
+        }
+
+        unsigned ll configs[PROFILE_HW_COUNT]{
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+        };
+
+        //счетчики наследуются потоками, значения завершившихся потоков добавляются к процессу
+        hw_enabled = true;
+        for (int i = 0; i < PROFILE_HW_COUNT; i++){
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = i == 3 ? PERF_TYPE_HW_CACHE : PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+
+            hw_fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            if(hw_fd[i] < 0){
+                hw_enabled = false;
+            }
+        }
+    }
+
+    ~Profiler(){
+        for (int i = 0; i < PROFILE_HW_COUNT; i++){
+            if(hw_fd[i] >= 0){
+                close(hw_fd[i]);
+            }
+        }
+    }
+
+    unsigned ll Now(){
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    }
+
+    void ReadHw(unsigned ll *values){
+        for (int i = 0; i < PROFILE_HW_COUNT; i++){
+            values[i] = 0;
+            if(read(hw_fd[i], &values[i], sizeof(values[i])) != sizeof(values[i])){
+                values[i] = 0;
+            }
+        }
+    }
+};
+
+Profiler profiler;
+
+//Номер текущего потока в отчете
+int ProfileTid(){
+    thread_local int tid = profiler.next_tid++;
+    return tid;
+}
+
+//Замер времени от создания до уничтожения объекта
+struct ProfileScope{
+    const char *name;
+    ProfileKind kind;
+    unsigned ll th_quant;
+    unsigned ll start_ns;
+    unsigned ll busy_ns = 0;
+    unsigned ll hw[PROFILE_HW_COUNT]{};
+
+    ProfileScope(const char *name, ProfileKind kind, unsigned ll th_quant)
+        : name(name), kind(kind), th_quant(th_quant){
+        if(kind == PROFILE_KIND_PHASE && profiler.hw_enabled){
+            profiler.ReadHw(hw);
+        }
+        if(kind == PROFILE_KIND_PARALLEL){
+            busy_ns = profiler.busy_ns;
+        }
+        start_ns = profiler.Now();
+    }
+
+    ~ProfileScope(){
+        ProfileEvent event{name, kind, ProfileTid(), start_ns, profiler.Now()-start_ns, false, {}};
+
+        if(kind == PROFILE_KIND_PHASE && profiler.hw_enabled){
+            unsigned ll now[PROFILE_HW_COUNT];
+            profiler.ReadHw(now);
+            for (int i = 0; i < PROFILE_HW_COUNT; i++){
+                event.hw[i] = now[i]-hw[i];
+            }
+            event.has_hw = true;
+        }
+        if(kind == PROFILE_KIND_WORKER){
+            profiler.busy_ns += event.dur_ns;
+        }
+        if(kind == PROFILE_KIND_PARALLEL){
+            unsigned ll busy = profiler.busy_ns - busy_ns;
+            if(th_quant*event.dur_ns > busy){
+                profiler.idle_ns += th_quant*event.dur_ns - busy;
+            }
+        }
+
+        lock_guard<mutex> guard(profiler.lock);
+        profiler.events.push_back(event);
+    }
+};
+
+//Запись отчета (JSON) и Chrome trace
+void ProfileReport(){
+    lock_guard<mutex> guard(profiler.lock);
+
+    const char *out = getenv("SIEVE_PROFILE_OUT");
+    string prefix = string(out && *out ? out : "sieve_profile") + "." + to_string(getpid());
+    int pid = getpid();
+
+    //Chrome trace: по событию "X" на замер
+    ofstream trace(prefix + ".trace.json");
+    //ts/dur в микросекундах, без экспоненциальной записи
+    trace << fixed << setprecision(3);
+    trace << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    trace << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"args\":{\"name\":\"sieve\"}}";
+    for (const ProfileEvent &e : profiler.events){
+        trace << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << e.tid
+              << ",\"ts\":" << e.start_ns/1000.0 << ",\"dur\":" << e.dur_ns/1000.0;
+        if(e.has_hw){
+            trace << ",\"args\":{";
+            for (int i = 0; i < PROFILE_HW_COUNT; i++){
+                trace << (i ? "," : "") << "\"" << profile_hw_names[i] << "\":" << e.hw[i];
+            }
+            trace << "}";
+        }
+        trace << "}";
+    }
+    trace << "\n]}\n";
+
+    //отчет: фазы (по имени, в порядке первого появления), потоки, счетчики
+    struct Phase{
+        string name;
+        unsigned ll calls = 0, total_ns = 0, max_ns = 0;
+        bool has_hw = false;
+        unsigned ll hw[PROFILE_HW_COUNT]{};
+    };
+    vector<Phase> phases;
+    map<int, pair<unsigned ll, unsigned ll>> threads;   //tid -> (количество замеров работы, время работы)
+
+    for (const ProfileEvent &e : profiler.events){
+        auto it = find_if(phases.begin(), phases.end(), [&](const Phase &ph){ return ph.name == e.name; });
+        if(it == phases.end()){
+            phases.push_back(Phase());
+            phases.back().name = e.name;
+            it = phases.end()-1;
+        }
+        it->calls++;
+        it->total_ns += e.dur_ns;
+        it->max_ns = max(it->max_ns, e.dur_ns);
+        if(e.has_hw){
+            it->has_hw = true;
+            for (int i = 0; i < PROFILE_HW_COUNT; i++){
+                it->hw[i] += e.hw[i];
+            }
+        }
+        if(e.kind == PROFILE_KIND_WORKER){
+            threads[e.tid].first++;
+            threads[e.tid].second += e.dur_ns;
+        }
+    }
+
+    ofstream report(prefix + ".json");
+    report << fixed << setprecision(6);
+    report << "{\n  \"pid\": " << pid << ",\n  \"wall_ms\": " << profiler.Now()/1e6
+           << ",\n  \"hw_counters\": " << (profiler.hw_enabled ? "true" : "false") << ",\n  \"phases\": [";
+    for (size_t i = 0; i < phases.size(); i++){
+        const Phase &ph = phases[i];
+        report << (i ? "," : "") << "\n    {\"name\": \"" << ph.name << "\", \"calls\": " << ph.calls
+               << ", \"total_ms\": " << ph.total_ns/1e6 << ", \"max_ms\": " << ph.max_ns/1e6;
+        if(ph.has_hw){
+            for (int j = 0; j < PROFILE_HW_COUNT; j++){
+                report << ", \"" << profile_hw_names[j] << "\": " << ph.hw[j];
+            }
+            report << ", \"ipc\": " << (ph.hw[0] ? (double)ph.hw[1]/ph.hw[0] : 0.0);
+        }
+        report << "}";
+    }
+    report << "\n  ],\n  \"threads\": [";
+    bool first = true;
+    for (const auto &t : threads){
+        report << (first ? "" : ",") << "\n    {\"tid\": " << t.first << ", \"events\": " << t.second.first
+               << ", \"busy_ms\": " << t.second.second/1e6 << "}";
+        first = false;
+    }
+    report << "\n  ],\n  \"counters\": {\"crossings\": " << profiler.crossings
+           << ", \"segments\": " << profiler.segments
+           << ", \"threads_spawned\": " << profiler.threads
+           << ", \"thread_busy_ms\": " << profiler.busy_ns/1e6
+           << ", \"thread_idle_ms\": " << profiler.idle_ns/1e6 << "}\n}\n";
+
+    cout << "Профиль записан в " << prefix << ".json и " << prefix << ".trace.json" << endl;
+}
+
+#else
+
+#define PROFILE_PHASE(name)
+#define PROFILE_WORKER(name)
+#define PROFILE_PARALLEL(name, th_quant)
+#define PROFILE_SCOPE(name)
+#define PROFILE_COUNT(counter, n)
+#define PROFILE_LOCAL(var)
+#define PROFILE_LOCAL_ADD(var, n)
+#define PROFILE_REPORT()
+
+#endif
+
 // Решето Эратосфена(v4)
 void SearchSimple_v4(bool *sieve, ll right){
 
+    PROFILE_PHASE("SearchSimple_v4");
+
     long right1 = right+1;
-    long sqrt_right1 = sqrt(right1);
+    long sqrt_right1 = sqrt(right1)+1;
 
     //Заполнение решета Эратосфена
     for (ll i = 0; i < right1; i++){
         sieve[i] = 1;
     }
+
+    sieve[0] = 0;
+    sieve[1] = 0;
     
     //Вычеркивание всех составных чисел
     for (ll p = 2; p < sqrt_right1; p++){
@@ -105,16 +475,16 @@ void SearchSimple_v4(bool *sieve, ll right){
             for (ll j = p*p; j < right1; j += p){
                 sieve[j] = 0;
             }      
+            PROFILE_COUNT(crossings, (right1-p*p+p-1)/p);
         }
     } 
-
-    cout << "Поиск завершен" << endl;
 }
 
 
 //Решето Эратосфена с использованием битовых масок
 void SearchSimple_v6(unsigned ll *sieve, unsigned ll right){ 
 
+    PROFILE_PHASE("SearchSimple_v6");
 
     unsigned ll right1 = right+1;
     unsigned ll sqrt_right1 = sqrt(right1)+1;
@@ -134,6 +504,7 @@ void SearchSimple_v6(unsigned ll *sieve, unsigned ll right){
             for (size_t j = p*p; j < right1; j += p){
                 sieve[j/64] = sieve[j/64] & ~((unsigned ll)1 << j);
             }
+            PROFILE_COUNT(crossings, (right1-p*p+p-1)/p);
         }
     }
 }
@@ -143,6 +514,8 @@ void SearchSimple_v6(unsigned ll *sieve, unsigned ll right){
 
 //Заполнение решета
 void SieveCompletion(bool *sieve, unsigned ll right){
+    PROFILE_PHASE("SieveCompletion");
+
     long right1 = right+1;
 
     //Заполнение решета Эратосфена
@@ -157,18 +530,23 @@ void SieveCompletion(bool *sieve, unsigned ll right){
 
 // Вычеркивает все числа, кратные Prime 
 void DeletePrime(bool *sieve, unsigned ll right, unsigned ll Prime){
+    PROFILE_WORKER("DeletePrime");
+
     unsigned ll right1 = right+1;
 
     for (size_t j = Prime*Prime; j < right1; j += Prime){ 
         sieve[j] = 0;
     }
 
+    PROFILE_COUNT(crossings, Prime*Prime < right1 ? (right1-Prime*Prime+Prime-1)/Prime : 0);
 }
 
 //Многопоточное решето Эратосфена.
 void SearchSimple(bool *sieve, thread *thr, ll right, int th_quant){
 
-    int first_primes[16]{2,3,5,7,11,13,17,19, 23, 29, 31, 37, 41, 43, 47, 51};
+    PROFILE_PARALLEL("SearchSimple", th_quant);
+
+    int first_primes[16]{2,3,5,7,11,13,17,19, 23, 29, 31, 37, 41, 43, 47, 53};
     unsigned ll right1 = right+1;
     unsigned ll sqrt_right1 = sqrt(right1)+1;    
     int th_num = 0;
@@ -177,11 +555,14 @@ void SearchSimple(bool *sieve, thread *thr, ll right, int th_quant){
     for(unsigned ll p = first_primes[th_quant-1]+1; p < sqrt_right1; p++){
 
         if(sieve[p]){
+            PROFILE_SCOPE("spawn");
+            PROFILE_COUNT(threads, 1);
             thr[th_num] = thread(DeletePrime, sieve, right, p);
             th_num++;
         }
 
         if(th_num == th_quant){
+            PROFILE_SCOPE("join");
             for (int i = 0; i < th_quant; i++){
                 thr[i].join();
             }
@@ -194,6 +575,170 @@ void SearchSimple(bool *sieve, thread *thr, ll right, int th_quant){
     }
 }
 
+//Многопоточное решето Эратосфена целиком (v7): заполнение решета, вычеркивание чисел,
+//кратных первым th_quant простым числам, и вычеркивание оставшихся составных чисел.
+void SearchSimple_v7(bool *sieve, unsigned ll right, int th_quant){
+
+    int first_primes[16]{2,3,5,7,11,13,17,19, 23, 29, 31, 37, 41, 43, 47, 53};
+    thread *thr = new thread[th_quant];
+
+    SieveCompletion(sieve, right);
+
+    //вычеркивание чисел, кратных первым простым числам
+    {
+        PROFILE_PARALLEL("first_primes", th_quant);
+        PROFILE_COUNT(threads, th_quant);
+
+        for (int i = 0; i < th_quant; i++){
+            thr[i] = thread(DeletePrime, sieve, right, first_primes[i]);
+        }
+
+        for (int i = 0; i < th_quant; i++){
+            thr[i].join();
+        }
+    }
+
+    SearchSimple(sieve, thr, right, th_quant);
+
+    delete[] thr;
+}
+
+
+//Сегментированное решето Эратосфена с колесом по модулю 2 (v8).
+
+//Целая часть квадратного корня (без ошибок округления sqrt для больших чисел)
+unsigned ll IntSqrt(unsigned ll n){
+    unsigned ll r = sqrt(n);
+
+    while(r*r > n){
+        r--;
+    }
+    while((r+1)*(r+1) <= n){
+        r++;
+    }
+
+    return r;
+}
+
+//Нечетные простые числа до limit включительно, ими вычеркиваются составные числа в сегментах
+vector<unsigned ll> BasePrimes(unsigned ll limit){
+    PROFILE_PHASE("BasePrimes");
+
+    vector<bool> composite(limit+1, false);
+    vector<unsigned ll> primes;
+
+    for (unsigned ll p = 3; p <= limit; p += 2){
+        if(!composite[p]){
+            primes.push_back(p);
+            for (unsigned ll j = p*p; j <= limit; j += 2*p){
+                composite[j] = true;
+            }
+        }
+    }
+
+    return primes;
+}
+
+//Обрабатывает сегменты с номерами first, first+step, first+2*step, ...
+//Сегмент - seg_words подряд идущих 64-битных блоков решета.
+//Блок sieve[0] соответствует числам left/64*64 ... left/64*64+63.
+void SieveSegments(unsigned ll *sieve, unsigned ll left, unsigned ll right, const vector<unsigned ll> *primes,
+                   unsigned ll seg_words, unsigned ll first, unsigned ll step){
+
+    PROFILE_WORKER("SieveSegments");
+
+    unsigned ll base = left/64;
+    unsigned ll num_bloks = right/64-base+1;
+    unsigned ll num_segs = (num_bloks+seg_words-1)/seg_words;
+    PROFILE_LOCAL(crossings);
+
+    for (unsigned ll s = first; s < num_segs; s += step){
+        unsigned ll w_lo = s*seg_words;
+        unsigned ll w_hi = min(w_lo+seg_words, num_bloks);
+        unsigned ll lo = (base+w_lo)*64;
+        unsigned ll hi = min((base+w_hi)*64-1, right);
+
+        PROFILE_COUNT(segments, 1);
+
+        //колесо: четные числа вычеркнуты сразу (биты с четными номерами равны 0)
+        for (unsigned ll w = w_lo; w < w_hi; w++){
+            sieve[w] = 0xaaaaaaaaaaaaaaaa;
+        }
+        if(lo == 0){
+            //0 и 1 не простые, 2 - простое
+            sieve[0] = 0xaaaaaaaaaaaaaaac;
+        }
+
+        //вычеркиваются только нечетные кратные: p*p, p*p+2p, ...
+        for (unsigned ll p : *primes){
+            unsigned ll start = p*p;
+            if(start > hi){
+                break;
+            }
+            if(start < lo){
+                start = (lo+p-1)/p*p;
+                if(start % 2 == 0){
+                    start += p;
+                }
+            }
+            PROFILE_LOCAL_ADD(crossings, start <= hi ? (hi-start)/(2*p)+1 : 0);
+            for (unsigned ll j = start-base*64; j <= hi-base*64; j += 2*p){
+                sieve[j/64] &= ~((unsigned ll)1 << (j % 64));
+            }
+        }
+
+        //биты чисел меньше left в первом блоке и больше right в последнем блоке обнуляются
+        if(w_lo == 0){
+            sieve[0] &= ~(((unsigned ll)1 << (left % 64)) - 1);
+        }
+        if(w_hi == num_bloks && right % 64 != 63){
+            sieve[w_hi-1] &= ((unsigned ll)1 << (right % 64 + 1)) - 1;
+        }
+    }
+    PROFILE_COUNT(crossings, crossings);
+}
+
+//Вычеркивание составных чисел от left до right по сегментам базовыми простыми числами primes
+//(все нечетные простые числа до корня из right). Сегменты распределяются между th_quant потоками по очереди.
+void SearchSegments(unsigned ll *sieve, unsigned ll left, unsigned ll right, const vector<unsigned ll> &primes,
+                    unsigned ll seg_bytes, int th_quant){
+
+    unsigned ll seg_words = max(seg_bytes/8, (unsigned ll)1);
+
+    if(th_quant <= 1){
+        SieveSegments(sieve, left, right, &primes, seg_words, 0, 1);
+        return;
+    }
+
+    PROFILE_PARALLEL("segments", th_quant);
+    PROFILE_COUNT(threads, th_quant);
+
+    thread *thr = new thread[th_quant];
+
+    for (int i = 0; i < th_quant; i++){
+        thr[i] = thread(SieveSegments, sieve, left, right, &primes, seg_words, (unsigned ll)i, (unsigned ll)th_quant);
+    }
+
+    for (int i = 0; i < th_quant; i++){
+        thr[i].join();
+    }
+
+    delete[] thr;
+}
+
+//Решето - битовые маски, как в v6 (бит i соответствует числу i).
+//Размер сегмента seg_bytes выбирается так, чтобы сегмент помещался в кэш.
+//Если задано left, решето строится только для чисел от left до right
+//и занимает right/64-left/64+1 блоков (sieve[0] - блок, содержащий left).
+void SearchSimple_v8(unsigned ll *sieve, unsigned ll right, unsigned ll seg_bytes, int th_quant, unsigned ll left = 0){
+
+    PROFILE_PHASE("SearchSimple_v8");
+
+    vector<unsigned ll> primes = BasePrimes(IntSqrt(right));
+
+    SearchSegments(sieve, left, right, primes, seg_bytes, th_quant);
+}
+
 //проверка, простое ли число (нужно только для проверки корректности алгоритма поиска простых чисел)
 bool Check(ll n){
     ll sq = sqrt(n)+1;
@@ -234,6 +779,8 @@ void OutputSimple(bool *sieve, unsigned ll left_border, unsigned ll right_border
     cin >> ans;
     
     if (ans == "y"){
+        PROFILE_PHASE("output");
+
         unsigned ll right1 = right_border+1;
 
         for(size_t i = left_border; i < right1; i++){
@@ -255,6 +802,37 @@ void OutputSimple(bool *sieve, unsigned ll left_border, unsigned ll right_border
 }
 
 
+//Вывод простых чисел (решето - битовые маски)
+void OutputSimple(unsigned ll *sieve, unsigned ll left_border, unsigned ll right_border){
+    string ans;
+
+    cout << "Желаете увидеть все найденные числа?(y - Да, n - Нет)" << endl;
+    cin >> ans;
+    
+    if (ans == "y"){
+        PROFILE_PHASE("output");
+
+        unsigned ll right1 = right_border+1;
+
+        for(size_t i = left_border; i < right1; i++){
+            if( sieve[i/64] & ((unsigned ll)1 << i % 64) ){
+                // cout << i << ", ";
+                 Check(i);
+            }
+        }
+
+        cout << endl;
+        cout << "Завершение программы..." << endl;  
+    }
+    else if(ans != "n"){
+        cout << "Некорректный ввод, завершение программы..." << endl;
+    }
+    else{
+        cout << "Завершение программы..." << endl;
+    }
+}
+
+
 //вывод для пользователя и установка корректных значений диапазона для работы программы
 void Swap(ll &left_border, ll &right_border){
 
@@ -277,168 +855,1314 @@ void Swap(ll &left_border, ll &right_border){
 }
 
 
-int main(int argc, char* argv[]){
+//Индекс rank/select над решетом из битовых масок.
 
+const unsigned ll RANK_SUPER_WORDS = 8;      //суперблок - 512 бит
+const unsigned ll RANK_BLOCK_SUPERS = 128;   //блок - 128 суперблоков (65536 бит)
+const unsigned ll SELECT_SAMPLE = 8192;      //шаг отсчетов для select
 
-    setlocale(LC_ALL, "Russian");
+struct RankSelect{
+    const unsigned ll *bits = nullptr;
+    unsigned ll right = 0;
+    unsigned ll num_words = 0;
+    unsigned ll num_supers = 0;
+    unsigned ll total = 0;              //количество простых чисел до right
+    vector<unsigned ll> blocks;         //количество единиц до начала блока
+    vector<unsigned short> supers;      //количество единиц от начала блока до начала суперблока
+    vector<unsigned ll> samples;        //samples[i] - суперблок, в котором лежит (i*SELECT_SAMPLE+1)-е простое
+};
 
-    try{
+//Блок решета с обнуленными битами чисел больше right
+unsigned ll RankWord(const RankSelect &rs, unsigned ll w){
+    if(w == rs.num_words-1 && rs.right % 64 != 63){
+        return rs.bits[w] & (((unsigned ll)1 << (rs.right % 64 + 1)) - 1);
+    }
+    return rs.bits[w];
+}
 
-        ll left_border = 1, right_border = 1;
+//Количество единиц до начала суперблока s
+unsigned ll SuperRank(const RankSelect &rs, unsigned ll s){
+    return rs.blocks[s/RANK_BLOCK_SUPERS] + rs.supers[s];
+}
 
-        //количество потоков, изменяется в программе
-        ll th_quant = 8;
+//Построение индекса над решетом bits до числа right (решето не копируется)
+void BuildRankSelect(RankSelect &rs, const unsigned ll *bits, unsigned ll right){
+    PROFILE_PHASE("BuildRankSelect");
 
-        //первые простые числа
-        int first_primes[16]{2,3,5,7,11,13,17,19, 23, 29, 31, 37, 41, 43, 47};
+    rs.bits = bits;
+    rs.right = right;
+    rs.num_words = right/64+1;
+    rs.num_supers = (rs.num_words+RANK_SUPER_WORDS-1)/RANK_SUPER_WORDS;
+    rs.blocks.clear();
+    rs.supers.clear();
+    rs.samples.clear();
+    rs.supers.reserve(rs.num_supers);
 
-        //массив потоков
-        thread *thr = new thread[th_quant];
+    unsigned ll acc = 0;
 
-        //если параметры не введены 
-        if(argc == 1){
-            cout << "Вы не ввели данные" << endl;
-            cout << "Завершение программы..." << endl;
+    for (unsigned ll s = 0; s < rs.num_supers; s++){
+        if(s % RANK_BLOCK_SUPERS == 0){
+            rs.blocks.push_back(acc);
         }
+        rs.supers.push_back(acc - rs.blocks.back());
 
-        //если введен 1 параметр
-        else if(argc == 2){
-            
-            string buff= argv[1];
+        unsigned ll w_hi = min((s+1)*RANK_SUPER_WORDS, rs.num_words);
+        for (unsigned ll w = s*RANK_SUPER_WORDS; w < w_hi; w++){
+            acc += __builtin_popcountll(RankWord(rs, w));
+        }
 
-            //проверка введенных данных
-            CheckInput(buff, right_border);
-            //установка границ диапазона для работы программы и вывод для пользователя
-            Swap(left_border, right_border);
+        while(rs.samples.size()*SELECT_SAMPLE+1 <= acc){
+            rs.samples.push_back(s);
+        }
+    }
 
-            cout << "Введите количество ядер (от 1 до 16 или не больше кол-ва ядер вашего процессора), которое будет задействованно при работе программы " << endl;
-            cin >> buff;
-            CheckInput(buff, th_quant);
-            if( 1>th_quant || th_quant>16){
-                throw invalid_argument("Неверно введенные данные");
-            }
-            // установка времени начала работы программы
-            auto start = chrono::high_resolution_clock::now();
+    rs.total = acc;
+}
 
-            //поиск простых чисел
+//Размер индекса в байтах
+unsigned ll RankSelectBytes(const RankSelect &rs){
+    return rs.blocks.size()*sizeof(unsigned ll) + rs.supers.size()*sizeof(unsigned short)
+         + rs.samples.size()*sizeof(unsigned ll);
+}
 
-            //создание решета
-            bool *sieve = new bool[right_border+1];
+//Количество простых чисел, не больших x
+unsigned ll Rank(const RankSelect &rs, unsigned ll x){
+    if(x > rs.right){
+        x = rs.right;
+    }
 
-            //заполнение решета
-            SieveCompletion(sieve, right_border);
+    unsigned ll w = x/64;
+    unsigned ll s = w/RANK_SUPER_WORDS;
+    unsigned ll r = SuperRank(rs, s);
 
-            //реализация многопоточного исполнения программы
+    for (unsigned ll i = s*RANK_SUPER_WORDS; i < w; i++){
+        r += __builtin_popcountll(rs.bits[i]);
+    }
 
-            //Вычеркивание чисел, кратных первым простым числам
-            for (int i = 0; i < th_quant; i++){
-                thr[i] = thread(DeletePrime, sieve, right_border, first_primes[i]);
-            }
+    unsigned ll mask = x % 64 == 63 ? ~(unsigned ll)0 : ((unsigned ll)1 << (x % 64 + 1)) - 1;
 
-            for (int i = 0; i < th_quant; i++){
-                thr[i].join();
-            }
+    return r + __builtin_popcountll(rs.bits[w] & mask);
+}
 
-            //Вычеркивание оставшихся составных чисел
-            SearchSimple(sieve, thr, right_border, th_quant);
+//k-е простое число (k от 1), 0 - если в решете меньше k простых чисел
+unsigned ll Select(const RankSelect &rs, unsigned ll k){
+    if(k == 0 || k > rs.total){
+        return 0;
+    }
 
-            // установка конца и вывод итогового времени работы алгоритма
-            auto end = chrono::high_resolution_clock::now();
-            chrono::duration<float> duration = end-start;
-            cout << "Время работы программы " << duration.count() << " s" << endl;
+    //последний суперблок s, до начала которого меньше k единиц, ищется между соседними отсчетами
+    unsigned ll i = (k-1)/SELECT_SAMPLE;
+    unsigned ll lo = rs.samples[i];
+    unsigned ll hi = i+1 < rs.samples.size() ? rs.samples[i+1] : rs.num_supers-1;
 
-            //вывод простых чисел по запросу пользователя
-            OutputSimple(sieve, left_border,right_border);
-            
-            //очистка памяти
-            delete[] sieve;
-            sieve = nullptr;
-            
+    while(lo < hi){
+        unsigned ll mid = (lo+hi+1)/2;
+        if(SuperRank(rs, mid) < k){
+            lo = mid;
+        }
+        else{
+            hi = mid-1;
         }
+    }
 
-        //если введено 2 параметра
-        else if(argc == 3){
-            
-            string buff = argv[1];
+    unsigned ll r = k - SuperRank(rs, lo);
 
-            //проверка введенных данных
-            CheckInput(buff, left_border);
+    for (unsigned ll w = lo*RANK_SUPER_WORDS; w < rs.num_words; w++){
+        unsigned ll word = RankWord(rs, w);
+        unsigned ll c = __builtin_popcountll(word);
 
-            buff = argv[2];
+        if(r <= c){
+            //сброс r-1 младших единиц
+            for (unsigned ll j = 1; j < r; j++){
+                word &= word-1;
+            }
+            return w*64 + __builtin_ctzll(word);
+        }
+        r -= c;
+    }
 
-            CheckInput(buff, right_border);
+    return 0;
+}
 
-            //установка границ диапазона
-            Swap(left_border, right_border);
-            
-            cout << "Введите количество ядер, котое будет задействованно при работе программы " << endl;
-            cin >> buff;
-            CheckInput(buff, th_quant);
-            if( 1>th_quant || th_quant>16){
-                throw invalid_argument("Неверно введенные данные");
-            }
+//Наименьшее простое число, большее x, 0 - если такого нет в решете
+unsigned ll NextPrime(const RankSelect &rs, unsigned ll x){
+    if(x >= rs.right){
+        return 0;
+    }
+    return Select(rs, Rank(rs, x)+1);
+}
 
-            // установка времени начала работы программы
-            auto start = chrono::high_resolution_clock::now();
 
-            //создание решета
-            bool *sieve = new bool[right_border+1];
+//Автоматический подбор параметров (калибровка).
+
+//Реализации решета, между которыми выбирает калибровка
+enum Engine{
+    ENGINE_BYTE,        //SearchSimple_v4, решето типа bool
+    ENGINE_BITSET,      //SearchSimple_v6, битовые маски
+    ENGINE_SEGMENTED,   //SearchSimple_v8, сегментированное решето с колесом
+    ENGINE_THREADS,     //SearchSimple_v7, многопоточное решето типа bool
+    ENGINE_COUNT
+};
+
+const char *engine_names[ENGINE_COUNT]{"byte", "bitset", "segmented", "threads"};
+
+//Параметры работы решета
+struct SieveConfig{
+    int engine = ENGINE_THREADS;
+    unsigned ll seg_bytes = 0;  //размер сегмента в байтах (только для ENGINE_SEGMENTED)
+    int th_quant = 1;           //количество потоков (для ENGINE_SEGMENTED и ENGINE_THREADS)
+};
+
+//Найденное решето: заполнено bytes (ENGINE_BYTE, ENGINE_THREADS) или bits (остальные)
+struct Sieve{
+    bool *bytes = nullptr;
+    unsigned ll *bits = nullptr;
+};
+
+//Создает решето и выполняет поиск простых чисел до right выбранной реализацией
+Sieve RunEngine(const SieveConfig &cfg, unsigned ll right){
+    PROFILE_PHASE("sieve");
+
+    Sieve sieve;
+
+    switch(cfg.engine){
+        case ENGINE_BYTE:
+            sieve.bytes = new bool[right+2];
+            SearchSimple_v4(sieve.bytes, right);
+            break;
+        case ENGINE_BITSET:
+            sieve.bits = new unsigned ll[right/64+1];
+            SearchSimple_v6(sieve.bits, right);
+            break;
+        case ENGINE_SEGMENTED:
+            sieve.bits = new unsigned ll[right/64+1];
+            SearchSimple_v8(sieve.bits, right, cfg.seg_bytes, cfg.th_quant);
+            break;
+        default:
+            sieve.bytes = new bool[right+2];
+            SearchSimple_v7(sieve.bytes, right, cfg.th_quant);
+            break;
+    }
 
-            //заполнение решета
-            SieveCompletion(sieve, right_border);
+    return sieve;
+}
 
-            //реализация многопоточного исполнения программы
+//Освобождает память решета
+void FreeSieve(Sieve &sieve){
+    delete[] sieve.bytes;
+    delete[] sieve.bits;
+    sieve.bytes = nullptr;
+    sieve.bits = nullptr;
+}
 
-            //Вычеркивание чисел, кратных первым простым числам
-            for (int i = 0; i < th_quant; i++){
-                thr[i] = thread(DeletePrime, sieve, right_border, first_primes[i]);
-            }
+//Описание конфигурации для вывода пользователю
+string ConfigName(const SieveConfig &cfg){
+    string name = engine_names[cfg.engine];
 
-            for (int i = 0; i < th_quant; i++){
-                thr[i].join();
-            }
+    if(cfg.engine == ENGINE_SEGMENTED){
+        name += ", сегмент " + to_string(cfg.seg_bytes/1024) + " КБ";
+    }
+    if(cfg.engine == ENGINE_SEGMENTED || cfg.engine == ENGINE_THREADS){
+        name += ", потоков " + to_string(cfg.th_quant);
+    }
+
+    return name;
+}
 
-            //Вычеркивание оставшихся составных чисел
-            SearchSimple(sieve, thr, right_border, th_quant);
-            // установка конца и вывод времени итогового работы алгоритма
-            auto end = chrono::high_resolution_clock::now();
-            chrono::duration<float> duration = end-start;
-            cout << "Время работы программы " << duration.count() << " s" << endl;
+//Читает целое число из файла (для файлов /sys), при ошибке возвращает -1
+ll ReadSysValue(const string &path){
+    ifstream in(path);
+    string str;
+    ll value = -1;
 
-            //вывод простых чисел по запросу пользователя
-            OutputSimple(sieve, left_border,right_border);
-            
-            //очистка памяти
-            delete[] sieve;
-            sieve = nullptr;
-          
+    if(in >> str){
+        size_t sz_res = 0;
+        try{
+            value = stoll(str, &sz_res, 10);
         }
-        //если введено 3 и более параметров
-        else{
-            cout << "Вы ввели слишком много параметров, макс кол-во - 2" << endl;
-            cout << "Завершение программы..." << endl;
+        catch(...){
+            return -1;
+        }
+        //размер кэша записан в виде "48K" или "2048K"
+        if(sz_res < str.size() && str[sz_res] == 'K'){
+            value *= 1024;
+        }
+        else if(sz_res < str.size() && str[sz_res] == 'M'){
+            value *= 1024*1024;
         }
     }
-    //при неверном формате ввода
-    catch (invalid_argument& e)
-    {
-        cout << e.what() << endl;
+
+    return value;
+}
+
+//Размеры кэша данных L1 и L2 в байтах
+void DetectCache(unsigned ll &l1, unsigned ll &l2){
+    ll sz1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    ll sz2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+
+    //если libc не знает размеров кэша, они читаются из /sys
+    for (int i = 0; i < 8 && (sz1 <= 0 || sz2 <= 0); i++){
+        string dir = "/sys/devices/system/cpu/cpu0/cache/index" + to_string(i) + "/";
+        ifstream type_in(dir + "type");
+        string type;
+        if(!(type_in >> type)){
+            break;
+        }
+        if(type == "Instruction"){
+            continue;
+        }
+        ll level = ReadSysValue(dir + "level");
+        ll size = ReadSysValue(dir + "size");
+        if(level == 1 && sz1 <= 0){
+            sz1 = size;
+        }
+        if(level == 2 && sz2 <= 0){
+            sz2 = size;
+        }
+    }
+
+    l1 = sz1 > 0 ? sz1 : 32*1024;
+    l2 = sz2 > 0 ? sz2 : 256*1024;
+}
+
+//Количество логических и физических ядер
+void DetectCores(int &logical, int &physical){
+    logical = thread::hardware_concurrency();
+    if(logical < 1){
+        logical = 1;
+    }
+
+    //физическое ядро - уникальная пара (номер процессора, номер ядра)
+    set<pair<ll, ll>> cores;
+    for (int i = 0; i < logical; i++){
+        string dir = "/sys/devices/system/cpu/cpu" + to_string(i) + "/topology/";
+        ll package = ReadSysValue(dir + "physical_package_id");
+        ll core = ReadSysValue(dir + "core_id");
+        if(core >= 0){
+            cores.insert(make_pair(package, core));
+        }
+    }
+
+    physical = cores.empty() ? logical : cores.size();
+}
+
+//Имя хоста, для которого сохраняется конфигурация
+string HostName(){
+    char name[256]{};
+
+    if(gethostname(name, sizeof(name)-1) != 0 || name[0] == 0){
+        return "localhost";
+    }
+
+    return name;
+}
+
+//Путь к файлу с конфигурациями
+string ConfigPath(){
+    const char *path = getenv("SIEVE_TUNE_FILE");
+    if(path && *path){
+        return path;
+    }
+
+    const char *home = getenv("HOME");
+    if(home && *home){
+        return string(home) + "/.sieve_tune";
+    }
+
+    return ".sieve_tune";
+}
+
+//Загружает конфигурацию для текущего хоста.
+//Формат строки файла: хост реализация размер_сегмента потоки N время
+bool LoadConfig(SieveConfig &cfg){
+    ifstream in(ConfigPath());
+    string line, host = HostName();
+
+    while(getline(in, line)){
+        istringstream ss(line);
+        string line_host, name;
+        SieveConfig tmp;
+
+        if(!(ss >> line_host >> name >> tmp.seg_bytes >> tmp.th_quant) || line_host != host){
+            continue;
+        }
+
+        tmp.engine = find(engine_names, engine_names+ENGINE_COUNT, name) - engine_names;
+
+        //конфигурация с некорректными значениями игнорируется
+        if(tmp.engine == ENGINE_COUNT || tmp.th_quant < 1){
+            continue;
+        }
+        if(tmp.engine == ENGINE_THREADS && tmp.th_quant > 16){
+            continue;
+        }
+        if(tmp.engine == ENGINE_SEGMENTED && tmp.seg_bytes < 8){
+            continue;
+        }
+
+        cfg = tmp;
+        return true;
+    }
+
+    return false;
+}
+
+//Сохраняет конфигурацию для текущего хоста, строки остальных хостов не изменяются
+void SaveConfig(const SieveConfig &cfg, unsigned ll bench_right, float seconds){
+    string path = ConfigPath(), host = HostName(), line;
+    vector<string> lines;
+
+    ifstream in(path);
+    while(getline(in, line)){
+        istringstream ss(line);
+        string line_host;
+        if(!(ss >> line_host) || line_host != host){
+            lines.push_back(line);
+        }
+    }
+    in.close();
+
+    ostringstream entry;
+    entry << host << " " << engine_names[cfg.engine] << " " << cfg.seg_bytes << " "
+          << cfg.th_quant << " " << bench_right << " " << seconds;
+    lines.push_back(entry.str());
+
+    ofstream out(path, ios::trunc);
+    for (const string &l : lines){
+        out << l << "\n";
+    }
+
+    if(!out){
+        throw runtime_error("Не удалось записать файл конфигурации " + path);
+    }
+}
+
+//Время работы решета с конфигурацией cfg до числа right (лучшее из repeats запусков)
+float BenchEngine(const SieveConfig &cfg, unsigned ll right, int repeats){
+    float best = 0;
+
+    for (int i = 0; i < repeats; i++){
+        auto start = chrono::high_resolution_clock::now();
+        Sieve sieve = RunEngine(cfg, right);
+        auto end = chrono::high_resolution_clock::now();
+        FreeSieve(sieve);
+
+        chrono::duration<float> duration = end-start;
+        if(i == 0 || duration.count() < best){
+            best = duration.count();
+        }
+    }
+
+    return best;
+}
+
+//Калибровка: перебор реализаций, размеров сегмента и количества потоков,
+//сохранение самой быстрой конфигурации для текущего хоста
+void Calibrate(unsigned ll bench_right){
+    unsigned ll l1 = 0, l2 = 0;
+    int logical = 1, physical = 1;
+
+    DetectCache(l1, l2);
+    DetectCores(logical, physical);
+
+    cout << "Хост: " << HostName() << endl;
+    cout << "Кэш L1d: " << l1/1024 << " КБ, L2: " << l2/1024 << " КБ" << endl;
+    cout << "Ядер: " << physical << " физических, " << logical << " логических" << endl;
+    cout << "Калибровка до числа " << bench_right << endl;
+
+    //количество потоков: степени двойки, количество физических и логических ядер
+    set<int> threads{1, physical, logical};
+    for (int t = 2; t < logical; t *= 2){
+        threads.insert(t);
+    }
+
+    //размер сегмента: половина и весь кэш L1, половина и весь кэш L2
+    set<unsigned ll> segments{l1/2, l1, l2/2, l2};
+
+    vector<SieveConfig> candidates;
+    SieveConfig cfg;
+
+    cfg.engine = ENGINE_BYTE;
+    candidates.push_back(cfg);
+    cfg.engine = ENGINE_BITSET;
+    candidates.push_back(cfg);
+
+    for (int t : threads){
+        //многопоточное решето v7 поддерживает не больше 16 потоков
+        if(t <= 16){
+            cfg.engine = ENGINE_THREADS;
+            cfg.th_quant = t;
+            candidates.push_back(cfg);
+        }
+        for (unsigned ll seg : segments){
+            cfg.engine = ENGINE_SEGMENTED;
+            cfg.seg_bytes = seg;
+            cfg.th_quant = t;
+            candidates.push_back(cfg);
+        }
+        cfg.seg_bytes = 0;
+    }
+
+    SieveConfig best;
+    float best_time = -1;
+
+    for (const SieveConfig &c : candidates){
+        float time = BenchEngine(c, bench_right, 2);
+        cout << ConfigName(c) << ": " << time << " s" << endl;
+
+        if(best_time < 0 || time < best_time){
+            best_time = time;
+            best = c;
+        }
+    }
+
+    SaveConfig(best, bench_right, best_time);
+
+    cout << "Лучшая конфигурация: " << ConfigName(best) << " (" << best_time << " s)" << endl;
+    cout << "Сохранено в " << ConfigPath() << endl;
+}
+
+
+//Поиск простых чисел в диапазоне [left_border, right_border], вывод времени работы и найденных чисел
+void Run(ll left_border, ll right_border){
+    SieveConfig cfg;
+
+    if(LoadConfig(cfg)){
+        cout << "Конфигурация хоста " << HostName() << ": " << ConfigName(cfg) << endl;
+    }
+    else{
+        string buff;
+        ll th_quant = 1;
+
+        cout << "Введите количество ядер (от 1 до 16 или не больше кол-ва ядер вашего процессора), которое будет задействованно при работе программы " << endl;
+        cout << "(чтобы подобрать параметры автоматически, запустите программу с параметром --tune)" << endl;
+        cin >> buff;
+        CheckInput(buff, th_quant);
+        if( 1>th_quant || th_quant>16){
+            throw invalid_argument("Неверно введенные данные");
+        }
+
+        cfg.engine = ENGINE_THREADS;
+        cfg.th_quant = th_quant;
+    }
+
+    // установка времени начала работы программы
+    auto start = chrono::high_resolution_clock::now();
+
+    //поиск простых чисел
+    Sieve sieve = RunEngine(cfg, right_border);
+
+    // установка конца и вывод итогового времени работы алгоритма
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<float> duration = end-start;
+    cout << "Время работы программы " << duration.count() << " s" << endl;
+
+    //вывод простых чисел по запросу пользователя
+    if(sieve.bytes){
+        OutputSimple(sieve.bytes, left_border, right_border);
+    }
+    else{
+        OutputSimple(sieve.bits, left_border, right_border);
+    }
+
+    //очистка памяти
+    FreeSieve(sieve);
+}
+
+
+//Количество запросов, генерируемых за раз при замере скорости (ограничивает память)
+const unsigned ll BENCH_BATCH = (unsigned ll)1 << 20;
+
+//Замер скорости ответа на count случайных запросов pi, nth и next
+void BenchQueries(const RankSelect &rs, unsigned ll count){
+    PROFILE_PHASE("BenchQueries");
+
+    mt19937_64 gen(12345);
+    vector<unsigned ll> values(min(count, BENCH_BATCH));
+    unsigned ll checksum = 0;
+    chrono::duration<float> duration(0);
+
+    //запросы генерируются пачками, время замеряется только для ответов
+    for (unsigned ll done = 0; done < count; ){
+        unsigned ll batch = min(count-done, BENCH_BATCH);
+
+        for (unsigned ll i = 0; i < batch; i++){
+            values[i] = (done+i) % 3 == 1 ? gen() % rs.total + 1 : gen() % rs.right;
+        }
+
+        auto start = chrono::high_resolution_clock::now();
+
+        for (unsigned ll i = 0; i < batch; i++){
+            if((done+i) % 3 == 0){
+                checksum += Rank(rs, values[i]);
+            }
+            else if((done+i) % 3 == 1){
+                checksum += Select(rs, values[i]);
+            }
+            else{
+                checksum += NextPrime(rs, values[i]);
+            }
+        }
+
+        auto end = chrono::high_resolution_clock::now();
+        duration += end-start;
+        done += batch;
+    }
+
+    cout << count << " запросов за " << duration.count() << " s, "
+         << (ll)(count/max(duration.count(), 1e-9f)) << " запросов/s (контрольная сумма " << checksum << ")" << endl;
+}
+
+//Построение решета до right с индексом rank/select и ответы на запросы со стандартного ввода
+void QueryMode(ll right){
+    SieveConfig cfg, tuned;
+    unsigned ll l1 = 0, l2 = 0;
+
+    //без сохраненной конфигурации сегментированного решета - сегмент по размеру L1d, все ядра
+    DetectCache(l1, l2);
+    cfg.engine = ENGINE_SEGMENTED;
+    cfg.seg_bytes = l1;
+    cfg.th_quant = max(thread::hardware_concurrency(), 1u);
+    if(LoadConfig(tuned) && tuned.engine == ENGINE_SEGMENTED){
+        cfg = tuned;
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+
+    Sieve sieve = RunEngine(cfg, right);
+    RankSelect rs;
+    BuildRankSelect(rs, sieve.bits, right);
+
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<float> duration = end-start;
+
+    unsigned ll sieve_bytes = (right/64+1)*sizeof(unsigned ll);
+    cout << "Решето и индекс построены за " << duration.count() << " s (" << ConfigName(cfg) << ")" << endl;
+    cout << "Простых чисел до " << right << ": " << rs.total << endl;
+    cout << "Индекс: " << RankSelectBytes(rs) << " байт (" << 100.0*RankSelectBytes(rs)/sieve_bytes << "% решета)" << endl;
+    cout << "Запросы: pi x, nth k, next x, bench M, q - выход" << endl;
+
+    string cmd, buff;
+
+    while(cin >> cmd && cmd != "q" && cin >> buff){
+        try{
+            ll value = 0;
+            CheckInput(buff, value);
+            if(value < 0){
+                throw invalid_argument("Неверно введенные данные");
+            }
+
+            if(cmd == "pi"){
+                if((unsigned ll)value > rs.right){
+                    cout << "Число больше правой границы решета" << endl;
+                }
+                else{
+                    cout << Rank(rs, value) << endl;
+                }
+            }
+            else if(cmd == "nth"){
+                unsigned ll p = Select(rs, value);
+                if(p == 0){
+                    cout << "Номер должен быть от 1 до " << rs.total << endl;
+                }
+                else{
+                    cout << p << endl;
+                }
+            }
+            else if(cmd == "next"){
+                unsigned ll p = NextPrime(rs, value);
+                if(p == 0){
+                    cout << "В решете нет простых чисел больше " << value << endl;
+                }
+                else{
+                    cout << p << endl;
+                }
+            }
+            else if(cmd == "bench"){
+                if(rs.total == 0){
+                    cout << "В решете нет простых чисел" << endl;
+                }
+                else{
+                    BenchQueries(rs, value);
+                }
+            }
+            else{
+                cout << "Неизвестный запрос " << cmd << endl;
+            }
+        }
+        catch(invalid_argument& e){
+            cout << e.what() << endl;
+        }
+        catch(out_of_range& e){
+            cout << "Вы ввели слишком большое число" << endl;
+        }
+        //решето остается в памяти, можно продолжать запросы
+        catch(bad_alloc& e){
+            cout << "Недостаточно оперативной памяти" << endl;
+        }
+    }
+
+    FreeSieve(sieve);
+}
+
+
+//Шардирование: обработка диапазона несколькими процессами с обменом через файлы.
+
+//Количество чисел, обрабатываемых обработчиком шарда за один проход решета (ограничивает память)
+const unsigned ll SHARD_WINDOW = (unsigned ll)1 << 27;
+
+//Размер части данных шарда, читаемой за раз при проверке и объединении
+const unsigned ll SHARD_CHUNK = (unsigned ll)1 << 20;
+
+//Начальное значение контрольной суммы FNV-1a
+const unsigned ll FNV_OFFSET = 0xcbf29ce484222325;
+
+//Результат обработки шарда
+struct Shard{
+    unsigned ll range_left = 0, range_right = 0;   //весь диапазон
+    unsigned ll index = 0, total = 0;              //номер шарда и количество шардов
+    unsigned ll left = 0, right = 0;               //границы шарда
+    unsigned ll count = 0, first = 0, last = 0;    //количество, первое и последнее простое (0 - нет)
+    float seconds = 0;
+    string config;
+    unsigned ll bytes = 0;                         //размер данных в файле
+    unsigned ll first_bytes = 0;                   //размер первой разности в файле
+    string error;                                  //ошибка чтения файла шарда
+};
+
+//Границы шарда index из total для диапазона [left, right]
+void ShardBounds(unsigned ll left, unsigned ll right, unsigned ll total, unsigned ll index,
+                 unsigned ll &lo, unsigned ll &hi){
+    unsigned ll len = right-left+1;
+    unsigned ll part = len/total, rest = len%total;
+
+    lo = left + index*part + min(index, rest);
+    hi = lo + part - (index < rest ? 0 : 1);
+}
+
+//Имя файла шарда
+string ShardPath(const string &prefix, unsigned ll index){
+    return prefix + "." + to_string(index) + ".shard";
+}
+
+//Запись числа в формате varint (по 7 бит, старший бит - признак продолжения)
+void PutVarint(string &out, unsigned ll value){
+    while(value >= 0x80){
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+//Контрольная сумма FNV-1a, hash - значение для предыдущих частей данных
+unsigned ll Fnv1a(const char *data, size_t size, unsigned ll hash = FNV_OFFSET){
+    for (size_t i = 0; i < size; i++){
+        hash = (hash ^ (unsigned char)data[i]) * 0x100000001b3;
+    }
+
+    return hash;
+}
+
+//Запись заголовка файла шарда. Поля, известные только после записи данных (количество, первое
+//и последнее простое, время, контрольная сумма, размер), записываются фиксированной ширины (20 символов),
+//поэтому после записи данных заголовок переписывается поверх прежнего с начала файла.
+void WriteShardHeader(ostream &out, const Shard &shard, unsigned ll checksum){
+    out << setfill('0')
+        << "format sieve-shard-1\n"
+        << "range " << shard.range_left << " " << shard.range_right << "\n"
+        << "shard " << shard.index << " " << shard.total << "\n"
+        << "left " << shard.left << "\n"
+        << "right " << shard.right << "\n"
+        << "count " << setw(20) << shard.count << "\n"
+        << "first " << setw(20) << shard.first << "\n"
+        << "last " << setw(20) << shard.last << "\n"
+        << "seconds " << setw(20) << fixed << setprecision(6) << shard.seconds << "\n"
+        << "config " << shard.config << "\n"
+        << "checksum " << setw(20) << checksum << "\n"
+        << "bytes " << setw(20) << shard.bytes << "\n"
+        << "data\n";
+}
+
+//Чтение заголовка файла шарда, поток остается в начале данных
+void ReadShardHeader(Shard &shard, ifstream &in, const string &path, unsigned ll &checksum){
+    if(!in){
+        throw runtime_error("Нет файла шарда " + path);
+    }
+
+    map<string, string> header;
+    string line;
+
+    while(getline(in, line) && line != "data"){
+        size_t sp = line.find(' ');
+        if(sp != string::npos){
+            header[line.substr(0, sp)] = line.substr(sp+1);
+        }
+    }
+
+    if(line != "data" || header["format"] != "sieve-shard-1"){
+        throw runtime_error("Неверный формат файла шарда " + path);
+    }
+
+    istringstream(header["range"]) >> shard.range_left >> shard.range_right;
+    istringstream(header["shard"]) >> shard.index >> shard.total;
+    istringstream(header["left"]) >> shard.left;
+    istringstream(header["right"]) >> shard.right;
+    istringstream(header["count"]) >> shard.count;
+    istringstream(header["first"]) >> shard.first;
+    istringstream(header["last"]) >> shard.last;
+    istringstream(header["seconds"]) >> shard.seconds;
+    istringstream(header["checksum"]) >> checksum;
+    istringstream(header["bytes"]) >> shard.bytes;
+    shard.config = header["config"];
+}
+
+//Чтение файла шарда и проверка данных: контрольной суммы, количества, границ и порядка простых чисел.
+//Данные читаются частями по SHARD_CHUNK байт и в памяти не сохраняются.
+void ReadShard(Shard &shard, const string &path){
+    ifstream in(path, ios::binary);
+    unsigned ll checksum = 0;
+
+    ReadShardHeader(shard, in, path, checksum);
+
+    vector<char> buf(min(shard.bytes, SHARD_CHUNK));
+    unsigned ll hash = FNV_OFFSET, rest = shard.bytes;
+    unsigned ll n = 0, prev = shard.left, gap = 0, first = 0, pos = 0;
+    int shift = 0;
+
+    while(rest > 0){
+        unsigned ll chunk = min(rest, SHARD_CHUNK);
+        in.read(buf.data(), chunk);
+        if((unsigned ll)in.gcount() != chunk){
+            throw runtime_error("Повреждены данные шарда " + path);
+        }
+        hash = Fnv1a(buf.data(), chunk, hash);
+
+        //разбор varint с учетом чисел, разделенных границей части
+        for (unsigned ll k = 0; k < chunk; k++, pos++){
+            unsigned char byte = buf[k];
+            if(shift >= 64){
+                throw runtime_error("Повреждены данные шарда " + path);
+            }
+            gap |= (unsigned ll)(byte & 0x7f) << shift;
+            shift += 7;
+            if(byte & 0x80){
+                continue;
+            }
+
+            //простые числа возрастают и лежат в границах шарда
+            if((n > 0 && gap == 0) || gap > shard.right-prev){
+                throw runtime_error("Повреждены данные шарда " + path);
+            }
+            prev += gap;
+            if(n == 0){
+                first = prev;
+                shard.first_bytes = pos+1;
+            }
+            n++;
+            gap = 0;
+            shift = 0;
+        }
+        rest -= chunk;
+    }
+
+    //данные не должны обрываться внутри числа и продолжаться после заявленного размера
+    if(shift != 0 || hash != checksum || in.peek() != EOF){
+        throw runtime_error("Повреждены данные шарда " + path);
+    }
+
+    if(n != shard.count || (n > 0 && (first != shard.first || prev != shard.last))){
+        throw runtime_error("Заголовок не соответствует данным шарда " + path);
+    }
+}
+
+//Обработчик шарда index: решето по окнам SHARD_WINDOW чисел, запись простых чисел в файл шарда
+void ShardWorker(unsigned ll left, unsigned ll right, unsigned ll total, unsigned ll index,
+                 const string &prefix, int th_quant){
+    PROFILE_PHASE("ShardWorker");
+
+    SieveConfig cfg, tuned;
+    unsigned ll l1 = 0, l2 = 0;
+
+    DetectCache(l1, l2);
+    cfg.engine = ENGINE_SEGMENTED;
+    cfg.seg_bytes = l1;
+    cfg.th_quant = 1;
+    if(LoadConfig(tuned) && tuned.engine == ENGINE_SEGMENTED){
+        cfg = tuned;
+    }
+    if(th_quant > 0){
+        cfg.th_quant = th_quant;
+    }
+
+    Shard shard;
+    shard.range_left = left;
+    shard.range_right = right;
+    shard.index = index;
+    shard.total = total;
+    shard.config = ConfigName(cfg);
+    ShardBounds(left, right, total, index, shard.left, shard.right);
+
+    auto start = chrono::high_resolution_clock::now();
+
+    //запись через временный файл, чтобы при объединении не встретился недописанный шард;
+    //разности каждого окна сразу дописываются в файл, заголовок переписывается в конце
+    string path = ShardPath(prefix, index), tmp = path + ".tmp";
+    ofstream out(tmp, ios::binary | ios::trunc);
+    WriteShardHeader(out, shard, 0);
+
+    //окно не больше шарда, базовые простые числа вычисляются один раз для всех окон
+    vector<unsigned ll> bits(min(SHARD_WINDOW, shard.right-shard.left+1)/64+2);
+    vector<unsigned ll> primes = BasePrimes(IntSqrt(shard.right));
+    unsigned ll prev = shard.left, hash = FNV_OFFSET;
+    string gaps;
+
+    for (unsigned ll a = shard.left; a <= shard.right; ){
+        unsigned ll b = shard.right-a < SHARD_WINDOW ? shard.right : a+SHARD_WINDOW-1;
+        unsigned ll base = a/64;
+
+        SearchSegments(bits.data(), a, b, primes, cfg.seg_bytes, cfg.th_quant);
+
+        gaps.clear();
+        for (unsigned ll w = 0; w <= b/64-base; w++){
+            unsigned ll word = bits[w];
+            while(word){
+                unsigned ll p = (base+w)*64 + __builtin_ctzll(word);
+                PutVarint(gaps, p-prev);
+                if(shard.count == 0){
+                    shard.first = p;
+                }
+                shard.last = p;
+                shard.count++;
+                prev = p;
+                word &= word-1;
+            }
+        }
+
+        {
+            PROFILE_SCOPE("WriteShard");
+
+            out.write(gaps.data(), gaps.size());
+            hash = Fnv1a(gaps.data(), gaps.size(), hash);
+            shard.bytes += gaps.size();
+        }
+
+        if(b == shard.right){
+            break;
+        }
+        a = b+1;
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<float> duration = end-start;
+    shard.seconds = duration.count();
+
+    out.seekp(0);
+    WriteShardHeader(out, shard, hash);
+    out.close();
+
+    if(!out || rename(tmp.c_str(), path.c_str()) != 0){
+        throw runtime_error("Не удалось записать файл шарда " + path);
+    }
+
+    cout << "Шард " << index << " [" << shard.left << ", " << shard.right << "]: "
+         << shard.count << " простых чисел, " << shard.seconds << " s" << endl;
+}
+
+//Читает файлы шардов с номерами first, first+step, ... (ошибка сохраняется в shard.error)
+void ReadShards(vector<Shard> *shards, const string *prefix, unsigned ll first, unsigned ll step){
+    PROFILE_WORKER("ReadShards");
+
+    for (unsigned ll i = first; i < shards->size(); i += step){
+        try{
+            ReadShard((*shards)[i], ShardPath(*prefix, i));
+        }
+        catch(exception& e){
+            (*shards)[i].error = e.what();
+        }
+    }
+}
+
+//Объединение файлов шардов: параллельная проверка, затем запись общего файла.
+//Данные шардов переписываются в общий файл частями, в памяти не хранятся.
+void MergeShards(unsigned ll left, unsigned ll right, unsigned ll total, const string &prefix){
+    auto start = chrono::high_resolution_clock::now();
+
+    vector<Shard> shards(total);
+    unsigned ll th_quant = min((unsigned ll)max(thread::hardware_concurrency(), 1u), total);
+
+    //параллельное чтение и проверка файлов шардов
+    {
+        PROFILE_PARALLEL("read_shards", th_quant);
+        PROFILE_COUNT(threads, th_quant);
+
+        thread *thr = new thread[th_quant];
+
+        for (unsigned ll i = 0; i < th_quant; i++){
+            thr[i] = thread(ReadShards, &shards, &prefix, i, th_quant);
+        }
+
+        for (unsigned ll i = 0; i < th_quant; i++){
+            thr[i].join();
+        }
+
+        delete[] thr;
+    }
+
+    //заголовок общего файла составляется по заголовкам шардов
+    Shard merged;
+    merged.range_left = merged.left = left;
+    merged.range_right = merged.right = right;
+    merged.index = 0;
+    merged.total = 1;
+    merged.config = "merged " + to_string(total) + " shards";
+
+    unsigned ll prev = left;
+    vector<string> first_gaps(total);   //первая разность шарда, пересчитанная от предыдущего простого
+
+    for (unsigned ll i = 0; i < total; i++){
+        Shard &shard = shards[i];
+        unsigned ll lo = 0, hi = 0;
+        ShardBounds(left, right, total, i, lo, hi);
+
+        if(!shard.error.empty()){
+            throw runtime_error(shard.error);
+        }
+        if(shard.range_left != left || shard.range_right != right || shard.index != i
+           || shard.total != total || shard.left != lo || shard.right != hi){
+            throw runtime_error("Шард " + ShardPath(prefix, i) + " относится к другому диапазону");
+        }
+
+        cout << "Шард " << i << " [" << lo << ", " << hi << "]: " << shard.count << " простых чисел, "
+             << shard.seconds << " s, " << shard.bytes << " байт (" << shard.config << ")" << endl;
+
+        merged.seconds += shard.seconds;
+
+        if(shard.count == 0){
+            continue;
+        }
+
+        PutVarint(first_gaps[i], shard.first-prev);
+
+        if(merged.count == 0){
+            merged.first = shard.first;
+        }
+        merged.last = shard.last;
+        merged.count += shard.count;
+        merged.bytes += first_gaps[i].size() + shard.bytes - shard.first_bytes;
+        prev = shard.last;
+    }
+
+    //данные шардов по порядку, заголовок с контрольной суммой переписывается в конце
+    string path = prefix + ".merged", tmp = path + ".tmp";
+    {
+        PROFILE_PHASE("concat");
+
+        ofstream out(tmp, ios::binary | ios::trunc);
+        WriteShardHeader(out, merged, 0);
+        unsigned ll hash = FNV_OFFSET;
+        vector<char> buf(min(merged.bytes, SHARD_CHUNK));
+
+        for (unsigned ll i = 0; i < total && out; i++){
+            if(shards[i].count == 0){
+                continue;
+            }
+
+            string shard_path = ShardPath(prefix, i);
+            ifstream in(shard_path, ios::binary);
+            Shard header;
+            unsigned ll checksum = 0;
+
+            ReadShardHeader(header, in, shard_path, checksum);
+            if(header.bytes != shards[i].bytes){
+                throw runtime_error("Файл шарда " + shard_path + " изменился во время объединения");
+            }
+            in.ignore(shards[i].first_bytes);
+
+            out.write(first_gaps[i].data(), first_gaps[i].size());
+            hash = Fnv1a(first_gaps[i].data(), first_gaps[i].size(), hash);
+
+            for (unsigned ll rest = shards[i].bytes - shards[i].first_bytes; rest > 0; ){
+                unsigned ll chunk = min(rest, SHARD_CHUNK);
+                in.read(buf.data(), chunk);
+                if((unsigned ll)in.gcount() != chunk){
+                    throw runtime_error("Файл шарда " + shard_path + " изменился во время объединения");
+                }
+                out.write(buf.data(), chunk);
+                hash = Fnv1a(buf.data(), chunk, hash);
+                rest -= chunk;
+            }
+        }
+
+        out.seekp(0);
+        WriteShardHeader(out, merged, hash);
+        out.close();
+
+        if(!out || rename(tmp.c_str(), path.c_str()) != 0){
+            throw runtime_error("Не удалось записать файл шарда " + path);
+        }
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<float> duration = end-start;
+
+    cout << "Простых чисел в [" << left << ", " << right << "]: " << merged.count << endl;
+    cout << "Суммарное время шардов " << merged.seconds << " s, объединение " << duration.count() << " s" << endl;
+    cout << "Результат записан в " << path << " (" << merged.bytes << " байт)" << endl;
+}
+
+//Координатор: запуск total локальных процессов-обработчиков шардов и объединение результата.
+//Одновременно работает не больше процессов, чем ядер; если хотя бы один обработчик завершился
+//с ошибкой, объединение не выполняется.
+void ShardCoordinator(unsigned ll left, unsigned ll right, unsigned ll total, const string &prefix){
+    unsigned ll cores = max(thread::hardware_concurrency(), 1u);
+    unsigned ll procs = min(cores, total);
+
+    //ядра делятся между процессами поровну
+    unsigned ll th_quant = cores/total;
+    if(th_quant < 1){
+        th_quant = 1;
+    }
+
+    string args[7]{"--shard-worker", to_string(left), to_string(right), to_string(total), "", prefix, to_string(th_quant)};
+    map<pid_t, unsigned ll> running;    //pid -> номер шарда
+    unsigned ll next = 0, failed = 0;
+    string error;
+
+    auto start = chrono::high_resolution_clock::now();
+
+    while(next < total || !running.empty()){
+
+        //запуск обработчиков, пока есть свободные ядра (после ошибки запуска новые не запускаются)
+        while(error.empty() && next < total && running.size() < procs){
+            args[4] = to_string(next);
+
+            char *argv[9]{(char*)"test"};
+            for (int j = 0; j < 7; j++){
+                argv[j+1] = (char*)args[j].c_str();
+            }
+            argv[8] = nullptr;
+
+            pid_t pid = 0;
+            if(posix_spawn(&pid, "/proc/self/exe", nullptr, nullptr, argv, environ) != 0){
+                error = "Не удалось запустить обработчик шарда " + to_string(next);
+                break;
+            }
+            running[pid] = next++;
+        }
+
+        if(running.empty()){
+            break;
+        }
+
+        //ожидание завершения любого из запущенных обработчиков
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if(pid < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            error = "Ошибка ожидания обработчиков шардов";
+            break;
+        }
+
+        auto it = running.find(pid);
+        if(it == running.end()){
+            continue;
+        }
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+            cout << "Обработчик шарда " << it->second << " завершился с ошибкой" << endl;
+            failed++;
+        }
+        running.erase(it);
+    }
+
+    if(!error.empty()){
+        throw runtime_error(error);
+    }
+    if(failed > 0){
+        throw runtime_error("Не обработано шардов: " + to_string(failed) + ", объединение не выполняется");
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<float> duration = end-start;
+    cout << "Шарды обработаны за " << duration.count() << " s" << endl;
+
+    MergeShards(left, right, total, prefix);
+}
+
+//Разбор параметров режимов шардирования: L R N [i] [префикс [потоки]]
+void ShardArgs(int argc, char* argv[], bool worker, ll &left, ll &right, ll &total, ll &index,
+               string &prefix, ll &th_quant){
+    int pos = 2;
+
+    if(argc < (worker ? 6 : 5) || argc > (worker ? 8 : 6)){
+        throw invalid_argument("Неверно введенные данные");
+    }
+
+    CheckInput(argv[pos++], left);
+    CheckInput(argv[pos++], right);
+    CheckInput(argv[pos++], total);
+    if(worker){
+        CheckInput(argv[pos++], index);
+    }
+    if(pos < argc){
+        prefix = argv[pos++];
+    }
+    if(pos < argc){
+        CheckInput(argv[pos++], th_quant);
+    }
+
+    if(left > right){
+        ll tmp = left;
+        left = right;
+        right = tmp;
+    }
+    if(left < 0 || total < 1 || (unsigned ll)total > (unsigned ll)(right-left)+1 || index < 0 || index >= total
+       || th_quant < 0 || prefix.empty()){
+        throw invalid_argument("Неверно введенные данные");
+    }
+}
+
+
+int main(int argc, char* argv[]){
+
+
+    setlocale(LC_ALL, "Russian");
+
+    //код завершения: 0 - успешно, 1 - ошибка (нужен внешним планировщикам обработчиков шардов)
+    int status = 0;
+
+    try{
+
+        ll left_border = 1, right_border = 1;
+
+        //калибровка
+        if(argc > 1 && string(argv[1]) == "--tune"){
+
+            ll bench_right = 50000000;
+
+            if(argc == 3){
+                CheckInput(argv[2], bench_right);
+            }
+            else if(argc > 3){
+                throw invalid_argument("Неверно введенные данные");
+            }
+            if(bench_right < 2){
+                throw invalid_argument("Неверно введенные данные");
+            }
+
+            Calibrate(bench_right);
+        }
+
+        //запросы к решету
+        else if(argc > 1 && string(argv[1]) == "--query"){
+
+            if(argc != 3){
+                throw invalid_argument("Неверно введенные данные");
+            }
+
+            CheckInput(argv[2], right_border);
+            if(right_border < 0){
+                throw invalid_argument("Неверно введенные данные");
+            }
+
+            QueryMode(right_border);
+        }
+
+        //шардирование
+        else if(argc > 1 && (string(argv[1]) == "--shard" || string(argv[1]) == "--shard-worker"
+                             || string(argv[1]) == "--merge")){
+
+            string mode = argv[1], prefix = "sieve";
+            ll total = 1, index = 0, th_quant = 0;
+
+            ShardArgs(argc, argv, mode == "--shard-worker", left_border, right_border, total, index, prefix, th_quant);
+
+            if(mode == "--shard"){
+                ShardCoordinator(left_border, right_border, total, prefix);
+            }
+            else if(mode == "--shard-worker"){
+                ShardWorker(left_border, right_border, total, index, prefix, th_quant);
+            }
+            else{
+                MergeShards(left_border, right_border, total, prefix);
+            }
+        }
+
+        //если параметры не введены 
+        else if(argc == 1){
+            cout << "Вы не ввели данные" << endl;
+            cout << "Завершение программы..." << endl;
+        }
+
+        //если введен 1 параметр
+        else if(argc == 2){
+            
+            string buff= argv[1];
+
+            //проверка введенных данных
+            CheckInput(buff, right_border);
+            //установка границ диапазона для работы программы и вывод для пользователя
+            Swap(left_border, right_border);
+
+            Run(left_border, right_border);
+        }
+
+        //если введено 2 параметра
+        else if(argc == 3){
+            
+            string buff = argv[1];
+
+            //проверка введенных данных
+            CheckInput(buff, left_border);
+
+            buff = argv[2];
+
+            CheckInput(buff, right_border);
+
+            //установка границ диапазона
+            Swap(left_border, right_border);
+
+            Run(left_border, right_border);
+        }
+        //если введено 3 и более параметров
+        else{
+            cout << "Вы ввели слишком много параметров, макс кол-во - 2" << endl;
+            cout << "Завершение программы..." << endl;
+        }
+    }
+    //при неверном формате ввода
+    catch (invalid_argument& e)
+    {
+        cout << e.what() << endl;
+        status = 1;
     }
     //при нелостатке оперативной памяти
     catch (bad_alloc& e)
     {
         cout << "Недостаточно оперативной памяти" << endl;
+        status = 1;
     }
     //при вводе слишком большого числа(диапазона)
     catch (out_of_range& e)
     {
         cout << "Вы ввели слишком большое число" << endl;
+        status = 1;
+    }
+    //при ошибке чтения или записи файлов (конфигурации, шардов) и запуска обработчиков шардов
+    catch (runtime_error& e)
+    {
+        cout << e.what() << endl;
+        status = 1;
     }
     catch(...){
         cout << "Непредвиденная ошибка" << endl;
+        status = 1;
     }
+
+    PROFILE_REPORT();
    
     cout << "Программа завершена" << endl;
 
-    return 0;
-}
\ No newline at end of file
+    return status;
+}